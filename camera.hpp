@@ -2,6 +2,7 @@
 #define CAMERA_HPP
 
 #include "essentials.hpp"
+#include "ray_packet.hpp"
 #include <cmath>
 #include <iostream>
 std::ostream &operator<<(std::ostream &o, const Vec3 &v) {
@@ -20,6 +21,8 @@ class Camera {
     Vec3 x_dir, y_dir, z_dir;
 
     double aperture;
+    double view_height; // viewport height at unit distance
+    double pixel_spread = 0; // footprint growth of a primary ray per unit distance, see set_image_height
 public:
     Camera (
         const point3d &lookfrom, // origin
@@ -34,6 +37,7 @@ public:
         double theta = PI * viewport_vert_fov/180;
         double viewport_height = 2 * std::tan(theta/2);
         double viewport_width  = viewport_height * aspect_ratio;
+        view_height = viewport_height;
 
         z_dir = unit_vector(lookfrom - lookat);
         x_dir = unit_vector(cross(camera_up, z_dir));
@@ -51,13 +55,60 @@ public:
         // std::cout << lower_left_corner << std::endl;
     }
 
+    // lets primary rays carry their pixel footprint (used to pick texture mip levels)
+    void set_image_height(int image_height) {
+        pixel_spread = view_height / image_height;
+    }
+
     // parameterize the screen by [0,1]x[0,1]
     Ray get_ray(double u, double v) const {
         auto [radius, theta] = sampler.random_polar_in_unit_disk();
         radius *= aperture/2; // sample from the lens uniformly
         point3d ray_start_point = origin + radius * std::cos(theta) * x_dir + radius * std::sin(theta) * y_dir;
         point3d ray_end_point = lower_left_corner + u*horizontal + v*vertical; 
-        return {ray_start_point, ray_end_point - ray_start_point};
+        return {ray_start_point, ray_end_point - ray_start_point, pixel_spread};
+    }
+
+    // one jittered ray per pixel for the block of pixels [i0, i0+bw) x [j0, j0+bh) (j counted from the
+    // bottom row, bw*bh <= PACKET_SIZE), in row-major order, same distribution as get_ray. Also sets
+    // up the packet's culling frustum.
+    void get_ray_packet(int i0, int j0, int bw, int bh, int image_width, int image_height, RayPacket &packet) const {
+        packet.n = bw * bh;
+        packet.spread = pixel_spread;
+        for (int dj = 0; dj < bh; dj++) {
+            for (int di = 0; di < bw; di++) {
+                double u = (i0 + di + sampler.random_double()) / (image_width - 1);
+                double v = (j0 + dj + sampler.random_double()) / (image_height - 1);
+                Ray r = get_ray(u, v);
+                int k = dj * bw + di;
+                packet.ox[k] = r.origin().x(); packet.oy[k] = r.origin().y(); packet.oz[k] = r.origin().z();
+                packet.dx[k] = r.direction().x(); packet.dy[k] = r.direction().y(); packet.dz[k] = r.direction().z();
+            }
+        }
+
+        // Every ray leaves the lens disk and passes through the block's rectangle on the focus plane.
+        // Each side plane contains one edge of the rectangle and touches the far side of the lens,
+        // so beyond the lens all rays stay inside; shifting it by the lens radius covers the lens too.
+        double u0 = double(i0) / (image_width - 1), u1 = double(i0 + bw) / (image_width - 1);
+        double v0 = double(j0) / (image_height - 1), v1 = double(j0 + bh) / (image_height - 1);
+        double um = (u0 + u1) / 2, vm = (v0 + v1) / 2;
+        double lens = aperture / 2;
+        point3d edge[4] = {
+            lower_left_corner + u0*horizontal + vm*vertical, // left
+            lower_left_corner + u1*horizontal + vm*vertical, // right
+            lower_left_corner + um*horizontal + v0*vertical, // bottom
+            lower_left_corner + um*horizontal + v1*vertical  // top
+        };
+        Vec3 side[4] = {-x_dir, x_dir, -y_dir, y_dir}; // outward
+        for (int k = 0; k < 4; k++) {
+            Vec3 along = (k < 2) ? y_dir : x_dir; // direction of the rectangle's edge
+            Vec3 n = unit_vector(cross(edge[k] - (origin - lens * side[k]), along));
+            if (dot(n, side[k]) < 0) n = -n;
+            packet.plane_n[k] = n;
+            packet.plane_d[k] = dot(n, origin) + lens * std::abs(dot(n, side[k])) + EPS;
+        }
+        packet.eye = origin;
+        packet.forward = -z_dir;
     }
 };
 
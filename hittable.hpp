@@ -2,6 +2,8 @@
 #define HITTABLE_HPP
 
 #include "essentials.hpp"
+#include "ray_packet.hpp"
+#include <memory>
 
 class Material;
 
@@ -10,6 +12,11 @@ struct hit_record {
     Vec3 normal; // surface normal (against the incident ray).
     double t; // perhaps useful sometimes.
 
+    // surface coordinates of the hit, for textures. uv_width is roughly how much of [0,1] in uv the
+    // ray's footprint covers here (0 if unknown, i.e. sample the finest detail).
+    double u = 0, v = 0;
+    double uv_width = 0;
+
     // what's the material of the hit
     std::shared_ptr<Material> mat_ptr;
     
@@ -20,12 +27,59 @@ struct hit_record {
     }
 };
 
+class hittable;
+
+// closest hits found so far for each ray of a packet. Objects with a vectorized hit_packet only
+// record t and themselves in obj; the full hit_record is filled in once at the end by resolve().
+struct packet_hit_record {
+    double t[PACKET_SIZE];
+    const hittable *obj[PACKET_SIZE]; // nullptr if no hit, or if rec is already complete
+    bool hit[PACKET_SIZE];
+    hit_record rec[PACKET_SIZE];
+
+    packet_hit_record() {
+        for (int i = 0; i < PACKET_SIZE; i++) {
+            t[i] = INFINITY;
+            obj[i] = nullptr;
+            hit[i] = false;
+        }
+    }
+    void resolve(const RayPacket &packet);
+};
+
 class hittable {
 public:
     virtual bool hit(const Ray& r, double t_min, double t_max, hit_record& rec) const = 0;
+
+    // intersect a whole packet, keeping for each ray whichever is closer: the hit in hits or this one.
+    // The default traces the rays one by one.
+    virtual void hit_packet(const RayPacket &packet, double t_min, packet_hit_record &hits) const {
+        for (int i = 0; i < packet.n; i++) {
+            hit_record tmp;
+            if (hit(packet.ray(i), t_min, hits.t[i], tmp)) {
+                hits.t[i] = tmp.t;
+                hits.rec[i] = tmp;
+                hits.obj[i] = nullptr;
+                hits.hit[i] = true;
+            }
+        }
+    }
+    // fill rec for a hit at t found by a vectorized hit_packet
+    virtual void set_hit_record(const Ray &r, double t, hit_record &rec) const {}
+    // a sphere containing the object, if it has one (used to cull packets)
+    virtual bool bounding_sphere(point3d &center, double &radius) const { return false; }
+
     virtual ~hittable(){}
 };
 
+void packet_hit_record::resolve(const RayPacket &packet) {
+    for (int i = 0; i < packet.n; i++) {
+        if (obj[i]) {
+            obj[i]->set_hit_record(packet.ray(i), t[i], rec[i]);
+            obj[i] = nullptr;
+        }
+    }
+}
 
 
 #endif
\ No newline at end of file
@@ -2,23 +2,56 @@
 #define HITTABLE_LIST_HPP
 
 #include "hittable.hpp"
+#include <algorithm>
 #include <vector>
 #include <memory>
 
 class hittable_list: public hittable {
     std::vector<std::shared_ptr<hittable>> objects;
+
+    // sphere around everything in the list, kept up to date by add() while every object has one
+    bool bounded = true;
+    point3d bound_center;
+    double bound_radius = -1; // empty
 public:
     hittable_list() {}
     hittable_list(std::shared_ptr<hittable> object) {
         add(object);
     }
     
-    void add(std::shared_ptr<hittable> object) { objects.push_back(object); }
-    void clear() { objects.clear(); }
+    void add(std::shared_ptr<hittable> object);
+    void clear() {
+        objects.clear();
+        bounded = true;
+        bound_radius = -1;
+    }
 
     virtual bool hit(const Ray& r, double t_min, double t_max, hit_record& rec) const override;
+    virtual void hit_packet(const RayPacket &packet, double t_min, packet_hit_record &hits) const override;
+    virtual bool bounding_sphere(point3d &center, double &radius) const override {
+        if (!bounded || bound_radius < 0) return false;
+        center = bound_center;
+        radius = bound_radius;
+        return true;
+    }
 };
 
+void hittable_list::add(std::shared_ptr<hittable> object) {
+    objects.push_back(object);
+    point3d c;
+    double r;
+    if (!bounded) return;
+    if (!object->bounding_sphere(c, r)) { bounded = false; return; }
+    if (bound_radius < 0) { bound_center = c; bound_radius = r; return; }
+    // smallest sphere containing both
+    double dist = (c - bound_center).length();
+    if (dist + r <= bound_radius) return;
+    if (dist + bound_radius <= r) { bound_center = c; bound_radius = r; return; }
+    double new_radius = (dist + r + bound_radius) / 2;
+    bound_center = bound_center + ((new_radius - bound_radius) / dist) * (c - bound_center);
+    bound_radius = new_radius;
+}
+
 bool hittable_list::hit(const Ray& r, double t_min, double t_max, hit_record& rec) const {
     bool hit_anything = false;
     for (const std::shared_ptr<hittable> &object: objects) {
@@ -31,4 +64,32 @@ bool hittable_list::hit(const Ray& r, double t_min, double t_max, hit_record& re
     }
     return hit_anything;
 }
+
+void hittable_list::hit_packet(const RayPacket &packet, double t_min, packet_hit_record &hits) const {
+    // once every ray has hit something, objects lying entirely behind the farthest hit can be skipped
+    bool all_hit = false;
+    double max_depth = INFINITY;
+    const double fx = packet.forward.x(), fy = packet.forward.y(), fz = packet.forward.z();
+    const double eye_depth = dot(packet.forward, packet.eye);
+
+    for (const std::shared_ptr<hittable> &object: objects) {
+        point3d c;
+        double r;
+        if (object->bounding_sphere(c, r)) {
+            if (packet.outside_frustum(c, r)) continue;
+            if (all_hit && packet.depth(c) - r > max_depth) continue;
+        }
+        object->hit_packet(packet, t_min, hits);
+
+        all_hit = true;
+        max_depth = 0;
+        for (int i = 0; i < packet.n; i++) {
+            double depth = fx * (packet.ox[i] + hits.t[i] * packet.dx[i])
+                         + fy * (packet.oy[i] + hits.t[i] * packet.dy[i])
+                         + fz * (packet.oz[i] + hits.t[i] * packet.dz[i]) - eye_depth;
+            all_hit = all_hit && hits.hit[i];
+            max_depth = std::max(max_depth, depth);
+        }
+    }
+}
 #endif
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 #include "essentials.hpp"
 #include "hittable.hpp"
+#include "texture.hpp"
 
 class Material {
 public:
@@ -13,30 +14,32 @@ public:
 
 // diffuse material
 class Lambertian: public Material {
-    RGBcolor albedo; // how much is reflected [0,1].
+    std::shared_ptr<Texture> albedo; // how much is reflected [0,1].
 public:
-    Lambertian(const RGBcolor &albedo): albedo(albedo) {}
+    Lambertian(const RGBcolor &albedo): albedo(std::make_shared<SolidColor>(albedo)) {}
+    Lambertian(std::shared_ptr<Texture> albedo): albedo(albedo) {}
 
     virtual bool scatter(const Ray& reflected, const hit_record& rec, RGBcolor& attenuation, Ray& incident) const override {
         Vec3 incident_dirn = rec.normal + sampler.random_unit_vector();
         if (incident_dirn == 0) incident_dirn = rec.normal;
         incident = Ray(rec.p, incident_dirn);
-        attenuation = albedo;
+        attenuation = albedo->value(rec);
         return true;
     }
 };
 
 // specular material (reflects)
 class Metal: public Material {
-    RGBcolor albedo;
+    std::shared_ptr<Texture> albedo;
     double fuzz;
 public:
-    Metal(const RGBcolor &albedo, double fuzz): albedo(albedo), fuzz(std::min(fuzz, 1.0)) {}
+    Metal(const RGBcolor &albedo, double fuzz): albedo(std::make_shared<SolidColor>(albedo)), fuzz(std::min(fuzz, 1.0)) {}
+    Metal(std::shared_ptr<Texture> albedo, double fuzz): albedo(albedo), fuzz(std::min(fuzz, 1.0)) {}
 
     virtual bool scatter(const Ray& reflected, const hit_record& rec, RGBcolor& attenuation, Ray& incident) const override {
         Vec3 incident_dirn = reflect(reflected.direction(), rec.normal) + fuzz * sampler.random_unit_vector();
         incident = Ray(rec.p, incident_dirn);
-        attenuation = albedo;
+        attenuation = albedo->value(rec);
         return dot(incident_dirn, rec.normal) > EPS;
     }
 };
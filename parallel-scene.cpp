@@ -4,13 +4,19 @@
 #include "sphere.hpp"
 #include "camera.hpp"
 #include "material.hpp"
+#include "thread_pool.hpp"
 
 #include <iostream>
+#include <fstream>
+#include <sstream>
 #include <thread>
 #include <cmath>
 #include <mutex>
+#include <atomic>
+#include <chrono>
 
-hittable_list random_scene()
+// texture (optional) wraps the big diffuse sphere at (-4, 1, 0)
+hittable_list random_scene(const char *texture = nullptr)
 {
     hittable_list world;
     auto ground_material = std::make_shared<Lambertian>(RGBcolor(0.5, 0.5, 0.5));
@@ -53,7 +59,9 @@ hittable_list random_scene()
     }
     auto material1 = std::make_shared<Dielectric>(1.0, 1.5, 1.0);
     world.add(std::make_shared<Sphere>(point3d(0, 1, 0), 1.0, material1));
-    auto material2 = std::make_shared<Lambertian>(RGBcolor(0.4, 0.2, 0.1));
+    auto material2 = texture
+        ? std::make_shared<Lambertian>(std::make_shared<ImageTexture>(texture))
+        : std::make_shared<Lambertian>(RGBcolor(0.4, 0.2, 0.1));
     world.add(std::make_shared<Sphere>(point3d(-4, 1, 0), 1.0, material2));
     auto material3 = std::make_shared<Metal>(RGBcolor(0.7, 0.6, 0.5), 0.0);
     world.add(std::make_shared<Sphere>(point3d(4, 1, 0), 1.0, material3));
@@ -62,14 +70,12 @@ hittable_list random_scene()
 
 // the goal is to compute the color of the ray at each pixel.
 
-RGBcolor ray_color(const Ray &r, const hittable_list &h, int stackdepth)
+RGBcolor ray_color(const Ray &r, const hittable_list &h, int stackdepth);
+
+// color of ray r given what (if anything) it hit
+RGBcolor shade(const Ray &r, bool hit, const hit_record &rec, const hittable_list &h, int stackdepth)
 {
-    if (stackdepth <= 0)
-    {
-        return {0, 0, 0}; // low probability event, return whatever (contributes v.less to averaged pixel color)
-    }
-    hit_record rec;
-    if (h.hit(r, 0.0001, INFINITY, rec))
+    if (hit)
     {
         // it actually hits. Find an incident vector and trace that back
         RGBcolor attenuation;
@@ -85,25 +91,67 @@ RGBcolor ray_color(const Ray &r, const hittable_list &h, int stackdepth)
     return (1 - t) * WHITE + t * RGBcolor(0.7, 0.8, 1.0);
 }
 
+RGBcolor ray_color(const Ray &r, const hittable_list &h, int stackdepth)
+{
+    if (stackdepth <= 0)
+    {
+        return {0, 0, 0}; // low probability event, return whatever (contributes v.less to averaged pixel color)
+    }
+    hit_record rec;
+    bool hit = h.hit(r, 0.0001, INFINITY, rec);
+    return shade(r, hit, rec, h, stackdepth);
+}
+
+// primary rays of a block are traced together; the bounces after that are incoherent, so each
+// one continues on its own through ray_color.
+void packet_color(const RayPacket &packet, const hittable_list &h, int stackdepth, RGBcolor *colors)
+{
+    packet_hit_record hits;
+    h.hit_packet(packet, 0.0001, hits);
+    hits.resolve(packet);
+    for (int k = 0; k < packet.n; k++)
+    {
+        colors[k] += shade(packet.ray(k), hits.hit[k], hits.rec[k], h, stackdepth);
+    }
+}
+
 std::vector<RGBcolor> pixels;
 std::mutex console_mutex; // mutex for thread terminal access
 
+int count_blocks(int image_width, int image_height)
+{
+    return ((image_width + PACKET_DIM - 1) / PACKET_DIM) * ((image_height + PACKET_DIM - 1) / PACKET_DIM);
+}
+
+// renders block idx of PACKET_DIM x PACKET_DIM pixels (numbered row-major from the bottom left) into pixels
+void render_block(const Camera &cam, const hittable_list &world, int image_width, int image_height, int idx, int n_samples, std::vector<RGBcolor> &pixels)
+{
+    const int blocks_x = (image_width + PACKET_DIM - 1) / PACKET_DIM;
+    int i0 = (idx % blocks_x) * PACKET_DIM;
+    int j0 = (idx / blocks_x) * PACKET_DIM;
+    int bw = std::min(PACKET_DIM, image_width - i0);
+    int bh = std::min(PACKET_DIM, image_height - j0);
+
+    RayPacket packet;
+    RGBcolor cum_color[PACKET_SIZE];
+    for (int _ = 0; _ < n_samples; ++_)
+    {
+        cam.get_ray_packet(i0, j0, bw, bh, image_width, image_height, packet);
+        packet_color(packet, world, 50, cum_color);
+    }
+
+    for (int dj = 0; dj < bh; dj++)
+        for (int di = 0; di < bw; di++)
+            pixels[(image_height-1 - (j0 + dj)) * image_width + i0 + di] = cum_color[dj * bw + di]/n_samples;
+}
+
+// renders blocks [start_n, end_n) into the global pixels, with a progress bar per thread
 void render(int thread_id, const Camera &cam, const hittable_list &world, int image_width, int image_height, int start_n, int end_n, int n_samples)
 {
     for (int idx = start_n; idx < end_n; idx++) {
-        RGBcolor cum_color;
-        for (int _ = 0; _ < n_samples; ++_)
-        {
-            int i = idx%image_width;
-            int j = image_height-1 - idx/image_width;
-            double u = (i + sampler.random_double()) / (image_width - 1);
-            double v = (j + sampler.random_double()) / (image_height - 1);
-            Ray r = cam.get_ray(u, v);
-            cum_color += ray_color(r, world, 50);
-        }
+        render_block(cam, world, image_width, image_height, idx, n_samples, pixels);
 
-        pixels[idx] = cum_color/n_samples;
-        if ((idx - start_n) % 100 == 0) {
+        if ((idx - start_n) % 10 == 0) {
             int progress = ((idx - start_n) * 100) / (end_n - start_n);
             int bar_width = 30; // Width of the progress bar
             int filled = (progress * bar_width) / 100;
@@ -126,28 +174,162 @@ void render(int thread_id, const Camera &cam, const hittable_list &world, int im
               << "] 100%\033[K" << std::flush;
 }
 
-void output(int image_width, int image_height, const std::vector<RGBcolor> &pixels) {
-    std::cerr << "Writing image to stdout...";
-    std::cout << "P3\n" << image_width << " " << image_height << "\n255\n";
+void write_image(std::ostream &ost, int image_width, int image_height, const std::vector<RGBcolor> &pixels) {
+    ost << "P3\n" << image_width << " " << image_height << "\n255\n";
     for (int idx = 0; idx < image_width * image_height; idx++) {
-        write_color(std::cout, pixels[idx]);
+        write_color(ost, pixels[idx]);
     }
+}
+
+void output(int image_width, int image_height, const std::vector<RGBcolor> &pixels) {
+    std::cerr << "Writing image to stdout...";
+    write_image(std::cout, image_width, image_height, pixels);
     std::cerr << "Done.\n";
 }
 
+void print_texture_stats() {
+    TextureCacheStats st = texture_cache.stats();
+    std::cerr << format("Texture cache: % hits, % misses (% hit rate), % evictions, %/% MB resident\n",
+                        st.hits, st.misses, st.hit_rate(), st.evictions, st.resident_bytes >> 20, st.budget_bytes >> 20);
+}
+
+// one image of a batch: a camera, its output file, and the bookkeeping of its blocks in flight
+struct View {
+    std::string path;
+    int image_width, image_height, n_samples;
+    Camera cam;
+
+    std::vector<RGBcolor> pixels; // allocated when the first block starts, freed once written
+    std::once_flag started;
+    std::atomic<int> blocks_left;
+    std::chrono::steady_clock::time_point start, rendered, written;
+
+    View(const std::string &path, int image_width, int image_height, int n_samples, const Camera &cam)
+        : path(path), image_width(image_width), image_height(image_height), n_samples(n_samples), cam(cam),
+          blocks_left(count_blocks(image_width, image_height)) {}
+};
 
-int main()
+// One view per line (blank lines and lines starting with # are skipped):
+//   output.ppm width height samples  from_x from_y from_z  at_x at_y at_z  vfov focus_dist aperture
+std::vector<std::unique_ptr<View>> read_views(const std::string &path)
 {
+    std::ifstream in(path);
+    if (!in) throw std::runtime_error(format("cannot open %", path));
+    std::vector<std::unique_ptr<View>> views;
+    std::string line;
+    for (int lineno = 1; std::getline(in, line); lineno++) {
+        std::istringstream ss(line);
+        std::string out;
+        if (!(ss >> out) || out[0] == '#') continue;
+        int w, h, samples;
+        double fx, fy, fz, ax, ay, az, vfov, focus_dist, aperture;
+        if (!(ss >> w >> h >> samples >> fx >> fy >> fz >> ax >> ay >> az >> vfov >> focus_dist >> aperture) || w < 2 || h < 2 || samples < 1)
+            throw std::runtime_error(format("%:%: expected: output width height samples from(3) at(3) vfov focus_dist aperture", path, lineno));
+        Camera cam({fx, fy, fz}, {ax, ay, az}, {0, 1, 0}, double(w) / h, vfov, focus_dist, aperture);
+        cam.set_image_height(h);
+        views.push_back(std::make_unique<View>(out, w, h, samples, cam));
+    }
+    return views;
+}
+
+// Renders every view against the same world on one pool of threads. All blocks are queued up front,
+// view after view, so workers move on to the next view as soon as the current one runs out of blocks;
+// the worker finishing a view's last block writes that image while the others keep rendering.
+// Returns the number of views whose image could not be written.
+int render_batch(const hittable_list &world, std::vector<std::unique_ptr<View>> &views, int n_threads)
+{
+    using clock = std::chrono::steady_clock;
+    auto ms = [](clock::duration d) { return std::chrono::duration<double, std::milli>(d).count(); };
+    const auto batch_start = clock::now();
+    std::atomic<int> failed{0};
+    {
+        ThreadPool pool(n_threads);
+        for (size_t v = 0; v < views.size(); v++) {
+            View &view = *views[v];
+            int n_blocks = count_blocks(view.image_width, view.image_height);
+            for (int idx = 0; idx < n_blocks; idx++) {
+                pool.submit([&world, &view, &ms, &failed, batch_start, idx, v] {
+                    std::call_once(view.started, [&view] {
+                        view.start = clock::now();
+                        view.pixels = std::vector<RGBcolor>(view.image_width * view.image_height);
+                    });
+                    render_block(view.cam, world, view.image_width, view.image_height, idx, view.n_samples, view.pixels);
+                    if (--view.blocks_left > 0) return;
+
+                    view.rendered = clock::now();
+                    std::ofstream out(view.path);
+                    write_image(out, view.image_width, view.image_height, view.pixels);
+                    out.close();
+                    view.pixels = std::vector<RGBcolor>();
+                    view.written = clock::now();
+
+                    std::lock_guard<std::mutex> lock(console_mutex);
+                    if (!out) {
+                        failed++;
+                        std::cerr << format("View %: failed writing %\n", v + 1, view.path);
+                        return;
+                    }
+                    std::cerr << format("View % (%): rendered in % ms, written in % ms, done % ms after batch start\n",
+                                        v + 1, view.path, ms(view.rendered - view.start), ms(view.written - view.rendered), ms(view.written - batch_start));
+                });
+            }
+        }
+        pool.wait();
+    }
+    double seconds = ms(clock::now() - batch_start) / 1000;
+
+    long long n_pixels = 0, n_samples = 0;
+    for (const auto &view: views) {
+        n_pixels += (long long)view->image_width * view->image_height;
+        n_samples += (long long)view->image_width * view->image_height * view->n_samples;
+    }
+    std::cerr << format("Batch: % views in % s, % Mpixel/s, % Msample/s\n",
+                        views.size(), seconds, n_pixels / seconds / 1e6, n_samples / seconds / 1e6);
+    if (failed > 0) std::cerr << format("Batch: % of % views failed to write\n", failed.load(), views.size());
+    return failed;
+}
+
+
+// usage: parallel-scene [texture.s2t] > image.ppm   (textures are made with texture-converter)
+//        parallel-scene --batch views.txt [texture.s2t]   (see read_views for the format)
+int main(int argc, char **argv)
+{
+    const int n_threads = 16;
+    if (argc > 1 && std::string(argv[1]) == "--batch") {
+        if (argc < 3) {
+            std::cerr << "usage: " << argv[0] << " --batch views.txt [texture.s2t]\n";
+            return 1;
+        }
+        int n_failed = 0;
+        try {
+            auto views = read_views(argv[2]);
+            auto world = random_scene(argc > 3 ? argv[3] : nullptr);
+            n_failed = render_batch(world, views, n_threads);
+        } catch (const std::exception &e) {
+            std::cerr << e.what() << "\n";
+            return 1;
+        }
+        if (argc > 3) print_texture_stats();
+        return n_failed ? 1 : 0;
+    }
+
     const auto aspect_ratio = 3.0 / 2.0;
     const int image_width = 1200;
     const int image_height= int(0.5 + image_width/aspect_ratio);
     point3d lookfrom{13, 2, 3}, lookat{0, 0, 0};
     Camera cam(lookfrom, lookat, {0, 1, 0}, aspect_ratio, 20.0, 10.0, 0.1);
-    auto world = random_scene();
+    cam.set_image_height(image_height);
+    hittable_list world;
+    try {
+        world = random_scene(argc > 1 ? argv[1] : nullptr);
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
 
-    const int n_threads = 16;
     const int N = image_width * image_height;
-    const int n_per_thread = N/n_threads + N%n_threads;
+    const int n_blocks = count_blocks(image_width, image_height);
+    const int n_per_thread = (n_blocks + n_threads - 1) / n_threads;
     
     std::thread threads[n_threads];
     pixels = std::vector<RGBcolor>(N);
@@ -162,11 +344,12 @@ int main()
     }
     
     for (int i = 0; i < n_threads; i++) {
-        int start_idx = i * n_per_thread;
-        int end_idx = (i == n_threads - 1) ? N : (i + 1) * n_per_thread;
+        int start_idx = std::min(i * n_per_thread, n_blocks);
+        int end_idx = std::min((i + 1) * n_per_thread, n_blocks);
         threads[i] = std::thread(render, i, std::cref(cam), std::cref(world), image_width, image_height, start_idx, end_idx, 50);
     }
     for (auto &thread: threads) thread.join();
     std::cerr << "\033[" << (n_threads + 1) << ";0HDone rendering!\n";
+    if (argc > 1) print_texture_stats();
     output(image_width, image_height, pixels);
 }
\ No newline at end of file
@@ -5,14 +5,16 @@
 class Ray {
     point3d orig;
     Vec3 dir;
+    double spr = 0; // how fast the ray's footprint widens per unit distance travelled (0 = a thin ray)
 public:
     // constructors
     Ray() {}
-    Ray(const point3d &origin, const Vec3 &dir): orig(origin), dir(dir){}
+    Ray(const point3d &origin, const Vec3 &dir, double spread = 0): orig(origin), dir(dir), spr(spread){}
 
     // access
     const point3d &origin() const { return orig; }
     const Vec3 &direction() const { return dir; }
+    double spread() const { return spr; }
 
     // operation
     Vec3 at(double t) const {
@@ -0,0 +1,41 @@
+#ifndef RAY_PACKET_HPP
+#define RAY_PACKET_HPP
+
+#include "essentials.hpp"
+
+// camera rays are traced in blocks of PACKET_DIM x PACKET_DIM pixels
+const int PACKET_DIM  = 8;
+const int PACKET_SIZE = PACKET_DIM * PACKET_DIM;
+
+// A bundle of coherent rays stored as structure-of-arrays, so that intersection loops over the
+// packet compile to SIMD code. Also carries a conservative frustum around all of its rays
+// (4 planes n.x <= d) and the common view axis, used to skip objects the packet cannot hit.
+struct RayPacket {
+    int n = 0;
+    double ox[PACKET_SIZE], oy[PACKET_SIZE], oz[PACKET_SIZE];
+    double dx[PACKET_SIZE], dy[PACKET_SIZE], dz[PACKET_SIZE];
+    double spread = 0;
+
+    Vec3 plane_n[4];
+    double plane_d[4];
+    point3d eye;  // every origin has the same depth as the eye along forward
+    Vec3 forward; // unit vector; all directions point along it
+
+    Ray ray(int i) const {
+        return {{ox[i], oy[i], oz[i]}, {dx[i], dy[i], dz[i]}, spread};
+    }
+
+    // true if a sphere is certainly missed by every ray in the packet
+    bool outside_frustum(const point3d &center, double radius) const {
+        for (int k = 0; k < 4; k++)
+            if (dot(plane_n[k], center) - plane_d[k] > radius) return true;
+        return false;
+    }
+
+    // distance of a point in front of the eye, measured along the view axis
+    double depth(const point3d &p) const {
+        return dot(forward, p - eye);
+    }
+};
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef SIMD_HPP
+#define SIMD_HPP
+
+// Thin wrappers over the widest double-precision SIMD the target is compiled for (AVX: 4 lanes,
+// SSE2: 2 lanes). Comparisons return lane masks that combine with simd_and/simd_or and pick values
+// with simd_select, so packet loops run without branches. HAVE_SIMD is left undefined on other
+// targets; callers then run their scalar loop over all rays.
+#if defined(__AVX__)
+#include <immintrin.h>
+#define HAVE_SIMD
+const int SIMD_WIDTH = 4;
+using vdouble = __m256d;
+
+inline vdouble simd_load(const double *p) { return _mm256_loadu_pd(p); }
+inline void simd_store(double *p, vdouble a) { _mm256_storeu_pd(p, a); }
+inline vdouble simd_set(double x) { return _mm256_set1_pd(x); }
+inline vdouble simd_add(vdouble a, vdouble b) { return _mm256_add_pd(a, b); }
+inline vdouble simd_sub(vdouble a, vdouble b) { return _mm256_sub_pd(a, b); }
+inline vdouble simd_mul(vdouble a, vdouble b) { return _mm256_mul_pd(a, b); }
+inline vdouble simd_div(vdouble a, vdouble b) { return _mm256_div_pd(a, b); }
+inline vdouble simd_sqrt(vdouble a) { return _mm256_sqrt_pd(a); }
+inline vdouble simd_max(vdouble a, vdouble b) { return _mm256_max_pd(a, b); }
+inline vdouble simd_gt(vdouble a, vdouble b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+inline vdouble simd_lt(vdouble a, vdouble b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+inline vdouble simd_ge(vdouble a, vdouble b) { return _mm256_cmp_pd(a, b, _CMP_GE_OQ); }
+inline vdouble simd_and(vdouble a, vdouble b) { return _mm256_and_pd(a, b); }
+inline vdouble simd_or(vdouble a, vdouble b) { return _mm256_or_pd(a, b); }
+// lanes of a where mask is set, lanes of b elsewhere
+inline vdouble simd_select(vdouble mask, vdouble a, vdouble b) { return _mm256_blendv_pd(b, a, mask); }
+// bit k set iff lane k of mask is set
+inline int simd_mask_bits(vdouble mask) { return _mm256_movemask_pd(mask); }
+
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define HAVE_SIMD
+const int SIMD_WIDTH = 2;
+using vdouble = __m128d;
+
+inline vdouble simd_load(const double *p) { return _mm_loadu_pd(p); }
+inline void simd_store(double *p, vdouble a) { _mm_storeu_pd(p, a); }
+inline vdouble simd_set(double x) { return _mm_set1_pd(x); }
+inline vdouble simd_add(vdouble a, vdouble b) { return _mm_add_pd(a, b); }
+inline vdouble simd_sub(vdouble a, vdouble b) { return _mm_sub_pd(a, b); }
+inline vdouble simd_mul(vdouble a, vdouble b) { return _mm_mul_pd(a, b); }
+inline vdouble simd_div(vdouble a, vdouble b) { return _mm_div_pd(a, b); }
+inline vdouble simd_sqrt(vdouble a) { return _mm_sqrt_pd(a); }
+inline vdouble simd_max(vdouble a, vdouble b) { return _mm_max_pd(a, b); }
+inline vdouble simd_gt(vdouble a, vdouble b) { return _mm_cmpgt_pd(a, b); }
+inline vdouble simd_lt(vdouble a, vdouble b) { return _mm_cmplt_pd(a, b); }
+inline vdouble simd_ge(vdouble a, vdouble b) { return _mm_cmpge_pd(a, b); }
+inline vdouble simd_and(vdouble a, vdouble b) { return _mm_and_pd(a, b); }
+inline vdouble simd_or(vdouble a, vdouble b) { return _mm_or_pd(a, b); }
+// lanes of a where mask is set, lanes of b elsewhere
+inline vdouble simd_select(vdouble mask, vdouble a, vdouble b) { return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b)); }
+// bit k set iff lane k of mask is set
+inline int simd_mask_bits(vdouble mask) { return _mm_movemask_pd(mask); }
+#endif
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef SPHERE_HPP
 #define SPHERE_HPP
 #include "hittable.hpp"
+#include "simd.hpp"
 
 class Sphere: public hittable {
     point3d cent;
@@ -11,6 +12,13 @@ public:
     Sphere(const point3d &center, const double radius, std::shared_ptr<Material> mat_ptr): cent(center), rad(radius), mat_ptr(mat_ptr) {}
 
     virtual bool hit(const Ray& r, double t_min, double t_max, hit_record& rec) const override;
+    virtual void hit_packet(const RayPacket &packet, double t_min, packet_hit_record &hits) const override;
+    virtual void set_hit_record(const Ray &r, double t, hit_record &rec) const override;
+    virtual bool bounding_sphere(point3d &center, double &radius) const override {
+        center = cent;
+        radius = std::abs(rad);
+        return true;
+    }
 };
 
 bool Sphere::hit(const Ray& r, double t_min, double t_max, hit_record& rec) const {
@@ -31,11 +39,75 @@ bool Sphere::hit(const Ray& r, double t_min, double t_max, hit_record& rec) cons
         t = t2;
     } else { return false; }
     
+    set_hit_record(r, t, rec);
+    return true;
+}
+
+// same test as hit, done for SIMD_WIDTH rays at a time with lane masks instead of branches.
+// Rays left over (or all of them, without SIMD) take the scalar path.
+void Sphere::hit_packet(const RayPacket &packet, double t_min, packet_hit_record &hits) const {
+    const double cx = cent.x(), cy = cent.y(), cz = cent.z(), rr = rad*rad;
+    int i = 0;
+#ifdef HAVE_SIMD
+    const vdouble vcx = simd_set(cx), vcy = simd_set(cy), vcz = simd_set(cz), vrr = simd_set(rr);
+    const vdouble zero = simd_set(0), eps = simd_set(EPS), lo = simd_set(t_min + EPS);
+    for (; i + SIMD_WIDTH <= packet.n; i += SIMD_WIDTH) {
+        vdouble rx = simd_sub(simd_load(packet.ox + i), vcx);
+        vdouble ry = simd_sub(simd_load(packet.oy + i), vcy);
+        vdouble rz = simd_sub(simd_load(packet.oz + i), vcz);
+        vdouble dx = simd_load(packet.dx + i), dy = simd_load(packet.dy + i), dz = simd_load(packet.dz + i);
+        vdouble a = simd_add(simd_add(simd_mul(dx, dx), simd_mul(dy, dy)), simd_mul(dz, dz));
+        vdouble half_b = simd_sub(zero, simd_add(simd_add(simd_mul(rx, dx), simd_mul(ry, dy)), simd_mul(rz, dz)));
+        vdouble c = simd_sub(simd_add(simd_add(simd_mul(rx, rx), simd_mul(ry, ry)), simd_mul(rz, rz)), vrr);
+        vdouble disc = simd_sub(simd_mul(half_b, half_b), simd_mul(a, c));
+        vdouble sqrtD = simd_sqrt(simd_max(disc, zero));
+        vdouble t1 = simd_div(simd_sub(half_b, sqrtD), a), t2 = simd_div(simd_add(half_b, sqrtD), a);
+        vdouble t_old = simd_load(hits.t + i), hi = simd_sub(t_old, eps);
+        vdouble ok1 = simd_and(simd_gt(t1, lo), simd_lt(t1, hi));
+        vdouble ok2 = simd_and(simd_gt(t2, lo), simd_lt(t2, hi));
+        vdouble is_hit = simd_and(simd_ge(disc, zero), simd_or(ok1, ok2));
+        simd_store(hits.t + i, simd_select(is_hit, simd_select(ok1, t1, t2), t_old));
+
+        int bits = simd_mask_bits(is_hit);
+        for (int k = 0; bits; k++, bits >>= 1) {
+            if (bits & 1) {
+                hits.obj[i + k] = this;
+                hits.hit[i + k] = true;
+            }
+        }
+    }
+#endif
+    for (; i < packet.n; i++) {
+        double rx = packet.ox[i] - cx, ry = packet.oy[i] - cy, rz = packet.oz[i] - cz;
+        double dx = packet.dx[i], dy = packet.dy[i], dz = packet.dz[i];
+        double a = dx*dx + dy*dy + dz*dz;
+        double half_b = -(rx*dx + ry*dy + rz*dz);
+        double c = rx*rx + ry*ry + rz*rz - rr;
+        double disc = half_b * half_b - a * c;
+        if (disc < 0) continue;
+        double sqrtD = std::sqrt(disc);
+        double t1 = (half_b - sqrtD)/a, t2 = (half_b + sqrtD)/a;
+        double lo = t_min + EPS, hi = hits.t[i] - EPS;
+        bool ok1 = t1 > lo && t1 < hi, ok2 = t2 > lo && t2 < hi;
+        if (!ok1 && !ok2) continue;
+        hits.t[i] = ok1 ? t1 : t2;
+        hits.obj[i] = this;
+        hits.hit[i] = true;
+    }
+}
+
+void Sphere::set_hit_record(const Ray &r, double t, hit_record &rec) const {
     rec.p = r.at(t);
     rec.t = t;
-    rec.set_face_normal(r, (rec.p - cent)/rad); // if rad is negative, this flips the direction: hollowness
+    Vec3 outward_normal = (rec.p - cent)/rad;
+    rec.set_face_normal(r, outward_normal); // if rad is negative, this flips the direction: hollowness
     rec.mat_ptr = mat_ptr;
-    return true;
+
+    // u: angle around the y axis from x=-1, v: angle from y=-1, both scaled to [0,1]
+    Vec3 n = outward_normal * (rad < 0 ? -1 : 1);
+    rec.u = (std::atan2(-n.z(), n.x()) + PI) / (2*PI);
+    rec.v = std::acos(clamp(-n.y(), -1, 1)) / PI;
+    rec.uv_width = r.spread() * t * r.direction().length() / (PI * std::abs(rad));
 }
 
 #endif
\ No newline at end of file
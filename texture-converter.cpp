@@ -0,0 +1,163 @@
+// Offline converter: turns a PPM image (P3 or P6) into the tiled, mip-mapped texture file that
+// ImageTexture/TextureCache read. Usage: texture-converter input.ppm output.s2t [tile_size]
+#include "texture_cache.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// one mip level, linear RGB
+struct Image {
+    int width, height;
+    std::vector<float> rgb;
+    float at(int x, int y, int c) const {
+        x = std::min(x, width - 1);
+        y = std::min(y, height - 1);
+        return rgb[3 * (size_t(y) * width + x) + c];
+    }
+};
+
+// skips whitespace and # comments of a PPM header, then reads a number
+int read_ppm_int(std::istream &in) {
+    while (true) {
+        int c = in.peek();
+        if (c == '#') { std::string _; std::getline(in, _); }
+        else if (std::isspace(c)) in.get();
+        else break;
+    }
+    int x;
+    if (!(in >> x)) throw std::runtime_error("malformed PPM header");
+    return x;
+}
+
+Image read_ppm(const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) throw std::runtime_error(format("cannot open %", path));
+    std::string magic;
+    in >> magic;
+    if (magic != "P3" && magic != "P6") throw std::runtime_error(format("% is not a P3/P6 PPM", path));
+    Image img;
+    img.width = read_ppm_int(in);
+    img.height = read_ppm_int(in);
+    int maxval = read_ppm_int(in);
+    if (img.width <= 0 || img.height <= 0 || maxval <= 0 || maxval > 65535) throw std::runtime_error(format("% has a bad PPM header", path));
+    in.get(); // the single whitespace before the raster
+
+    size_t n = size_t(3) * img.width * img.height;
+    img.rgb.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        int value;
+        if (magic == "P3") {
+            if (!(in >> value)) throw std::runtime_error(format("% is truncated", path));
+        } else if (maxval < 256) {
+            value = in.get();
+        } else {
+            value = in.get() << 8;
+            value |= in.get();
+        }
+        if (!in) throw std::runtime_error(format("% is truncated", path));
+        float c = float(value) / maxval;
+        img.rgb[i] = c * c; // same gamma 2 that write_color applies
+    }
+    return img;
+}
+
+// Source texels covering each destination texel along one axis, with the fraction of the
+// destination footprint each one covers. Halving an even size gives 2 taps of 1/2; halving an odd
+// size spreads n texels over (n+1)/2, so every source texel still contributes exactly its area.
+std::vector<std::vector<std::pair<int, float>>> box_weights(int src_n, int dst_n) {
+    std::vector<std::vector<std::pair<int, float>>> taps(dst_n);
+    double scale = double(src_n) / dst_n; // source texels per destination texel
+    for (int d = 0; d < dst_n; d++) {
+        double lo = d * scale, hi = (d + 1) * scale;
+        for (int s = int(lo); s < src_n && s < hi; s++) {
+            double covered = std::min(hi, s + 1.0) - std::max(lo, double(s));
+            if (covered > 0) taps[d].push_back({s, float(covered / scale)});
+        }
+    }
+    return taps;
+}
+
+// area-weighted 2x reduction
+Image downsample(const Image &src) {
+    Image dst;
+    dst.width = std::max(1, (src.width + 1) / 2);
+    dst.height = std::max(1, (src.height + 1) / 2);
+    dst.rgb.assign(size_t(3) * dst.width * dst.height, 0.f);
+    auto wx = box_weights(src.width, dst.width), wy = box_weights(src.height, dst.height);
+    for (int y = 0; y < dst.height; y++)
+        for (int x = 0; x < dst.width; x++)
+            for (auto [sy, fy]: wy[y])
+                for (auto [sx, fx]: wx[x])
+                    for (int c = 0; c < 3; c++)
+                        dst.rgb[3 * (size_t(y) * dst.width + x) + c] += fx * fy * src.at(sx, sy, c);
+    return dst;
+}
+
+void write_texture(const std::string &path, const std::vector<Image> &mips, int tile_size) {
+    TextureFileHeader header;
+    std::memcpy(header.magic, TEXTURE_MAGIC, 4);
+    header.version = TEXTURE_VERSION;
+    header.width = mips[0].width;
+    header.height = mips[0].height;
+    header.tile_size = tile_size;
+    header.n_levels = mips.size();
+
+    size_t tile_bytes = size_t(3) * tile_size * tile_size;
+    std::vector<TextureLevelInfo> levels(mips.size());
+    uint64_t offset = sizeof(header) + mips.size() * sizeof(TextureLevelInfo);
+    for (size_t l = 0; l < mips.size(); l++) {
+        levels[l].width = mips[l].width;
+        levels[l].height = mips[l].height;
+        levels[l].tiles_x = (mips[l].width + tile_size - 1) / tile_size;
+        levels[l].tiles_y = (mips[l].height + tile_size - 1) / tile_size;
+        levels[l].offset = offset;
+        offset += uint64_t(levels[l].tiles_x) * levels[l].tiles_y * tile_bytes;
+    }
+
+    std::ofstream out(path, std::ios::binary);
+    if (!out) throw std::runtime_error(format("cannot write %", path));
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(levels.data()), levels.size() * sizeof(TextureLevelInfo));
+
+    std::vector<unsigned char> tile(tile_bytes);
+    for (size_t l = 0; l < mips.size(); l++) {
+        for (uint32_t ty = 0; ty < levels[l].tiles_y; ty++) {
+            for (uint32_t tx = 0; tx < levels[l].tiles_x; tx++) {
+                for (int y = 0; y < tile_size; y++)
+                    for (int x = 0; x < tile_size; x++)
+                        for (int c = 0; c < 3; c++) {
+                            float v = mips[l].at(tx * tile_size + x, ty * tile_size + y, c);
+                            tile[3 * (y * tile_size + x) + c] = (unsigned char)(255 * clamp(std::sqrt(v), 0.0, 1.0) + 0.5);
+                        }
+                out.write(reinterpret_cast<const char *>(tile.data()), tile.size());
+            }
+        }
+    }
+    if (!out) throw std::runtime_error(format("failed writing %", path));
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        std::cerr << "usage: " << argv[0] << " input.ppm output.s2t [tile_size]\n";
+        return 1;
+    }
+    int tile_size = argc > 3 ? std::atoi(argv[3]) : 64;
+    if (tile_size <= 0 || uint32_t(tile_size) > TEXTURE_MAX_TILE_SIZE) {
+        std::cerr << format("tile_size must be between 1 and %\n", TEXTURE_MAX_TILE_SIZE);
+        return 1;
+    }
+    try {
+        std::vector<Image> mips{read_ppm(argv[1])};
+        while (mips.back().width > 1 || mips.back().height > 1) mips.push_back(downsample(mips.back()));
+        write_texture(argv[2], mips, tile_size);
+        std::cerr << format("wrote % (%x%, % levels, %x% tiles)\n", argv[2], mips[0].width, mips[0].height, mips.size(), tile_size, tile_size);
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef TEXTURE_HPP
+#define TEXTURE_HPP
+
+#include "essentials.hpp"
+#include "hittable.hpp"
+#include "texture_cache.hpp"
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+class Texture {
+public:
+    // color of the surface at the hit (uses rec.u, rec.v and, for filtering, rec.uv_width)
+    virtual RGBcolor value(const hit_record &rec) const = 0;
+    virtual ~Texture(){}
+};
+
+class SolidColor: public Texture {
+    RGBcolor color;
+public:
+    SolidColor(const RGBcolor &color): color(color) {}
+
+    virtual RGBcolor value(const hit_record &rec) const override {
+        return color;
+    }
+};
+
+// image texture backed by a preprocessed (tiled, mip-mapped) texture file. Only a handle is held;
+// the texels live in the shared TextureCache and are paged in tile by tile as they are looked up.
+class ImageTexture: public Texture {
+    TextureCache &cache;
+    int handle;
+    const TextureFile &file;
+public:
+    ImageTexture(const std::string &path, TextureCache &cache = texture_cache)
+        : cache(cache), handle(cache.load(path)), file(cache.file(handle)) {}
+
+    virtual RGBcolor value(const hit_record &rec) const override {
+        // pick the mip level whose texels are about as wide as the ray footprint
+        double texels = rec.uv_width * std::max(file.width(), file.height());
+        int level = texels > 1 ? int(std::log2(texels)) : 0;
+        level = std::min(level, file.n_levels() - 1);
+
+        // bilinear filtering within the level, wrapping in u and clamping in v
+        const TextureLevelInfo &info = file.level(level);
+        double x = (rec.u - std::floor(rec.u)) * info.width - 0.5;
+        double y = (1 - clamp(rec.v, 0, 1)) * info.height - 0.5; // v goes up, rows go down
+        int x0 = int(std::floor(x)), y0 = int(std::floor(y));
+        double fx = x - x0, fy = y - y0;
+
+        return (1 - fx) * (1 - fy) * texel(level, x0, y0)
+             + fx * (1 - fy) * texel(level, x0 + 1, y0)
+             + (1 - fx) * fy * texel(level, x0, y0 + 1)
+             + fx * fy * texel(level, x0 + 1, y0 + 1);
+    }
+
+private:
+    RGBcolor texel(int level, int x, int y) const {
+        const TextureLevelInfo &info = file.level(level);
+        int w = info.width, h = info.height;
+        x = ((x % w) + w) % w;
+        y = std::min(std::max(y, 0), h - 1);
+        int ts = file.tile_size();
+        auto tile = cache.get_tile(handle, file, level, x / ts, y / ts);
+        return tile->texel(x % ts, y % ts, ts);
+    }
+};
+
+#endif
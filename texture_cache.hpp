@@ -0,0 +1,285 @@
+#ifndef TEXTURE_CACHE_HPP
+#define TEXTURE_CACHE_HPP
+
+#include "essentials.hpp"
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// On-disk layout of a preprocessed texture (written by texture-converter.cpp):
+//   TextureFileHeader | TextureLevelInfo[n_levels] | tiles of level 0 | tiles of level 1 | ...
+// Every level is cut into tile_size x tile_size tiles (edge tiles are padded by clamping),
+// tiles are stored row-major, texels inside a tile are row-major 8-bit RGB (gamma 2, same as write_color).
+const char TEXTURE_MAGIC[4] = {'S', '2', 'T', 'X'};
+const uint32_t TEXTURE_VERSION = 1;
+const uint32_t TEXTURE_MAX_TILE_SIZE = 4096; // texels per tile side; larger headers are rejected as corrupt
+
+struct TextureFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t width, height; // of level 0
+    uint32_t tile_size;
+    uint32_t n_levels;
+};
+
+struct TextureLevelInfo {
+    uint32_t width, height;
+    uint32_t tiles_x, tiles_y;
+    uint64_t offset; // byte offset of the first tile of this level from the start of the file
+};
+
+// a read-only, mmap'd texture file. Pages are only faulted in when a tile is actually decoded.
+class TextureFile {
+    int fd = -1;
+    const unsigned char *data = nullptr;
+    size_t size = 0;
+    TextureFileHeader header;
+    std::vector<TextureLevelInfo> levels;
+public:
+    TextureFile(const std::string &path) {
+        fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error(format("cannot open texture %", path));
+        struct stat st;
+        if (fstat(fd, &st) < 0 || size_t(st.st_size) < sizeof(TextureFileHeader)) {
+            close(fd);
+            throw std::runtime_error(format("texture % is truncated", path));
+        }
+        size = st.st_size;
+        void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error(format("cannot mmap texture %", path));
+        }
+        data = static_cast<const unsigned char *>(mapped);
+
+        std::memcpy(&header, data, sizeof(header));
+        if (std::memcmp(header.magic, TEXTURE_MAGIC, 4) != 0 || header.version != TEXTURE_VERSION) {
+            release();
+            throw std::runtime_error(format("% is not a preprocessed texture (run texture-converter first)", path));
+        }
+        if (header.n_levels == 0 || header.n_levels > 64 || header.tile_size == 0 || header.tile_size > TEXTURE_MAX_TILE_SIZE || sizeof(header) + header.n_levels * sizeof(TextureLevelInfo) > size) {
+            release();
+            throw std::runtime_error(format("texture % has a corrupt header", path));
+        }
+        levels.resize(header.n_levels);
+        std::memcpy(levels.data(), data + sizeof(header), header.n_levels * sizeof(TextureLevelInfo));
+        // every level must be non-empty, covered by its tiles (at most 2^20 per axis, see TextureCache's
+        // keys), and lie inside the file
+        for (const TextureLevelInfo &info: levels) {
+            if (int(info.width) <= 0 || int(info.height) <= 0 || info.tiles_x > (1u << 20) || info.tiles_y > (1u << 20) ||
+                uint64_t(info.tiles_x) * header.tile_size < info.width ||
+                uint64_t(info.tiles_y) * header.tile_size < info.height) {
+                release();
+                throw std::runtime_error(format("texture % has a corrupt header", path));
+            }
+            if (info.offset > size || uint64_t(info.tiles_x) * info.tiles_y > (size - info.offset) / tile_bytes()) {
+                release();
+                throw std::runtime_error(format("texture % is truncated", path));
+            }
+        }
+    }
+    TextureFile(const TextureFile &) = delete;
+    TextureFile &operator=(const TextureFile &) = delete;
+    ~TextureFile() { release(); }
+
+    int width() const { return header.width; }
+    int height() const { return header.height; }
+    int tile_size() const { return header.tile_size; }
+    int n_levels() const { return header.n_levels; }
+    const TextureLevelInfo &level(int l) const { return levels[l]; }
+    size_t tile_bytes() const { return size_t(3) * header.tile_size * header.tile_size; }
+
+    // raw 8-bit texels of tile (tx, ty) of level l
+    const unsigned char *tile(int l, int tx, int ty) const {
+        const TextureLevelInfo &info = levels[l];
+        return data + info.offset + (size_t(ty) * info.tiles_x + tx) * tile_bytes();
+    }
+
+private:
+    void release() {
+        if (data) munmap(const_cast<unsigned char *>(data), size);
+        if (fd >= 0) close(fd);
+        data = nullptr;
+        fd = -1;
+    }
+};
+
+// a decoded tile: linear RGB, tile_size x tile_size texels
+struct TextureTile {
+    std::vector<float> texels;
+    size_t bytes() const { return texels.size() * sizeof(float); }
+    RGBcolor texel(int x, int y, int tile_size) const {
+        const float *t = &texels[3 * (size_t(y) * tile_size + x)];
+        return {t[0], t[1], t[2]};
+    }
+};
+
+struct TextureCacheStats {
+    uint64_t hits, misses, evictions;
+    size_t resident_bytes, budget_bytes;
+    double hit_rate() const { return (hits + misses) ? double(hits) / (hits + misses) : 0.; }
+};
+
+// Bounded cache of decoded tiles shared by all textures and all threads.
+// The key space is split over shards, each with its own mutex and LRU list, so threads only contend
+// when they touch the same shard at the same time; tile decoding happens outside the lock.
+// Each thread additionally remembers the last tile it used, which short-circuits the shard for
+// the (very common) case of consecutive lookups falling into the same tile. Those hits go to a
+// counter owned by the thread (so the fast path shares no cache line) that stats() sums up; the
+// cache keeps the counters alive, so hits of threads that have exited are still reported.
+class TextureCache {
+    static const int n_shards = 16;
+    struct Shard {
+        std::mutex mutex;
+        std::list<std::pair<uint64_t, std::shared_ptr<const TextureTile>>> lru; // front = most recent
+        std::unordered_map<uint64_t, decltype(lru)::iterator> index;
+        size_t bytes = 0;
+    };
+    Shard shards[n_shards];
+    size_t budget; // bytes, over all shards
+
+    std::mutex files_mutex;
+    std::vector<std::unique_ptr<TextureFile>> files;
+
+    std::atomic<uint64_t> hits{0}, misses{0}, evictions{0};
+
+    std::mutex counters_mutex;
+    std::vector<std::shared_ptr<std::atomic<uint64_t>>> memo_hits; // one per thread that used the cache
+
+    // tells caches apart in the thread-local memo, even one created at the address of a destroyed one
+    inline static std::atomic<uint64_t> next_id{1};
+    const uint64_t id;
+public:
+    TextureCache(size_t budget_bytes): budget(budget_bytes), id(next_id++) {}
+
+    // open a preprocessed texture and return its handle (an id into this cache)
+    int load(const std::string &path) {
+        auto file = std::make_unique<TextureFile>(path);
+        std::lock_guard<std::mutex> lock(files_mutex);
+        if (files.size() >= (1u << 16)) throw std::runtime_error("too many textures open");
+        files.push_back(std::move(file));
+        return int(files.size()) - 1;
+    }
+
+    // files are never removed, so the reference stays valid for the lifetime of the cache
+    const TextureFile &file(int handle) {
+        std::lock_guard<std::mutex> lock(files_mutex);
+        return *files[handle];
+    }
+
+    std::shared_ptr<const TextureTile> get_tile(int handle, const TextureFile &f, int level, int tx, int ty) {
+        uint64_t key = (uint64_t(handle) << 48) | (uint64_t(level) << 40) | (uint64_t(ty) << 20) | uint64_t(tx);
+
+        struct Memo {
+            uint64_t cache_id = 0, key = 0;
+            std::shared_ptr<const TextureTile> tile;
+            std::shared_ptr<std::atomic<uint64_t>> hits; // this thread's counter in cache cache_id
+        };
+        thread_local Memo memo;
+        thread_local std::unordered_map<uint64_t, std::shared_ptr<std::atomic<uint64_t>>> counters; // by cache id
+        if (memo.cache_id == id && memo.key == key) {
+            // only this thread writes the counter, so no read-modify-write is needed
+            memo.hits->store(memo.hits->load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return memo.tile;
+        }
+
+        std::shared_ptr<const TextureTile> tile = lookup(key);
+        if (tile) {
+            hits.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            misses.fetch_add(1, std::memory_order_relaxed);
+            tile = insert(key, decode(f, level, tx, ty));
+        }
+        if (memo.cache_id != id) {
+            std::shared_ptr<std::atomic<uint64_t>> &counter = counters[id];
+            if (!counter) counter = register_thread();
+            memo.hits = counter;
+            memo.cache_id = id;
+        }
+        memo.key = key;
+        memo.tile = tile;
+        return tile;
+    }
+
+    TextureCacheStats stats() {
+        size_t resident = 0;
+        for (Shard &s: shards) {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            resident += s.bytes;
+        }
+        uint64_t all_hits = hits.load();
+        {
+            std::lock_guard<std::mutex> lock(counters_mutex);
+            for (const auto &counter: memo_hits) all_hits += counter->load(std::memory_order_relaxed);
+        }
+        return {all_hits, misses.load(), evictions.load(), resident, budget};
+    }
+
+private:
+    std::shared_ptr<std::atomic<uint64_t>> register_thread() {
+        auto counter = std::make_shared<std::atomic<uint64_t>>(0);
+        std::lock_guard<std::mutex> lock(counters_mutex);
+        memo_hits.push_back(counter);
+        return counter;
+    }
+
+    Shard &shard_of(uint64_t key) {
+        return shards[(key ^ (key >> 20) ^ (key >> 40)) % n_shards];
+    }
+
+    std::shared_ptr<const TextureTile> lookup(uint64_t key) {
+        Shard &s = shard_of(key);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        auto it = s.index.find(key);
+        if (it == s.index.end()) return nullptr;
+        s.lru.splice(s.lru.begin(), s.lru, it->second);
+        return it->second->second;
+    }
+
+    std::shared_ptr<const TextureTile> insert(uint64_t key, std::shared_ptr<const TextureTile> tile) {
+        Shard &s = shard_of(key);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        // another thread may have decoded the same tile meanwhile; keep theirs
+        if (auto it = s.index.find(key); it != s.index.end()) return it->second->second;
+        s.lru.emplace_front(key, tile);
+        s.index[key] = s.lru.begin();
+        s.bytes += tile->bytes();
+        // evicted tiles stay alive for threads still holding them (shared_ptr)
+        while (s.bytes > budget / n_shards && s.lru.size() > 1) {
+            s.bytes -= s.lru.back().second->bytes();
+            s.index.erase(s.lru.back().first);
+            s.lru.pop_back();
+            evictions.fetch_add(1, std::memory_order_relaxed);
+        }
+        return tile;
+    }
+
+    static std::shared_ptr<const TextureTile> decode(const TextureFile &f, int level, int tx, int ty) {
+        auto tile = std::make_shared<TextureTile>();
+        size_t n = f.tile_bytes();
+        const unsigned char *raw = f.tile(level, tx, ty);
+        tile->texels.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            float c = raw[i] / 255.f;
+            tile->texels[i] = c * c; // undo the gamma 2 encoding
+        }
+        return tile;
+    }
+};
+
+// shared by every ImageTexture unless told otherwise
+TextureCache texture_cache(size_t(64) << 20);
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// fixed set of worker threads pulling tasks from one FIFO queue. Threads are started once and
+// reused for everything submitted, so a batch of renders pays for thread creation only once.
+class ThreadPool {
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable work_cv; // signalled when a task arrives or the pool stops
+    std::condition_variable idle_cv; // signalled when the last running task finishes
+    int busy = 0;
+    bool stopping = false;
+public:
+    ThreadPool(int n_threads) {
+        for (int i = 0; i < n_threads; i++) workers.emplace_back([this] { work(); });
+    }
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // runs whatever is still queued, then joins the workers
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        work_cv.notify_all();
+        for (std::thread &w: workers) w.join();
+    }
+
+    int size() const { return workers.size(); }
+
+    void submit(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push_back(std::move(task));
+        }
+        work_cv.notify_one();
+    }
+
+    // blocks until the queue is empty and no task is running (tasks may submit more tasks)
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        idle_cv.wait(lock, [this] { return tasks.empty() && busy == 0; });
+    }
+
+private:
+    void work() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                work_cv.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (tasks.empty()) return; // stopping and drained
+                task = std::move(tasks.front());
+                tasks.pop_front();
+                busy++;
+            }
+            task();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                busy--;
+                if (busy == 0 && tasks.empty()) idle_cv.notify_all();
+            }
+        }
+    }
+};
+
+#endif